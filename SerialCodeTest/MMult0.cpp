@@ -3,10 +3,12 @@
 // + Specify the the compiler version (using the command: "g++ -v")
 // + Try to find out the frequency, the maximum flop-rate and the maximum main
 //   memory bandwidth for your processor.
-// $ g++ -O3 -std=c++11 MMult0.cpp && ./a.out
+// $ g++ -O3 -std=c++11 -DGIT_REV="\"$(git rev-parse --short HEAD)\"" MMult0.cpp -I${PAPI_DIR}/include -L${PAPI_DIR}/lib -lpapi
+// $ ./a.out -results results.tsv
 
 #include <stdio.h>
 #include "utils.h"
+#include "results.h"
 #include <papi.h>
 
 void handle_error (int retval)
@@ -44,6 +46,7 @@ void MMult0( long m, long n, long k, double *a,
 int main(int argc, char** argv) {
     
   const long NREPEATS = 50;
+  std::string results = read_option<std::string>("-results", argc, argv, "");
   /*
   const long PFIRST = 20;
   const long PLAST = 600;
@@ -89,6 +92,10 @@ int main(int argc, char** argv) {
     double flops = (((2 * m * n * k) * NREPEATS) / 1e9) / time;
     double bandwidth = (((4 * m * n * k) * NREPEATS * sizeof(double)) / 1e9) / time;
     printf("%10ld %10f %10f %10f\n", p, time, flops, bandwidth);
+    // counters of the "computation" region are written by PAPI's high-level
+    // API to its own output directory, so no counter values are stored here
+    if (!results.empty())
+      append_result(results.c_str(), "MMult0", "", p, time, flops, bandwidth, "");
 
     free(a);
     free(b);
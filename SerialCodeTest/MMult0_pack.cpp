@@ -0,0 +1,271 @@
+// Blocked variant of MMult0 that packs A/B panels into contiguous buffers
+// before the inner kernel runs. The way data is streamed can be changed at
+// runtime to see which tricks actually reduce DRAM traffic:
+// + -pf <dist>: software prefetch <dist> doubles ahead while packing (0 = off)
+// + -nt <0|1>:  write C blocks back with non-temporal (streaming) stores
+// + -n <dim>, -mb <rows>, -nb <cols>: problem size and panel sizes
+// + -events <NAME,...>: extra PAPI events (preset or native) added with
+//   PAPI_add_named_event and reported after the LLC columns, e.g. memory
+//   controller CAS counts to see the write traffic that -nt changes:
+//   -events skx_unc_imc0::UNC_M_CAS_COUNT:RD:cpu=0,skx_unc_imc0::UNC_M_CAS_COUNT:WR:cpu=0
+//   (papi_native_avail lists the names available on your machine)
+// + -results <file>: also append the run to a results file (see results.h)
+// The LLC-miss column is PAPI_L3_TCM over the timed region and LLC-miss-GB/s
+// is those misses times the cache line size. PAPI_L3_TCM only counts demand
+// reads and RFOs (read-for-ownership loads before a write) that miss the LLC;
+// dirty writebacks and streaming stores are not included, so this is the
+// read side of the DRAM traffic, not the total.
+// Note on -nt: each C block is first read into cb with plain loads, so C's
+// lines are already cached when they are written back and there is no RFO
+// for a streaming store to save. What -nt can change here is that C is not
+// left dirty in the cache, which moves its write-back out of eviction time;
+// the write traffic itself is not visible in the LLC-miss columns, only in
+// write-side events passed with -events.
+// $ g++ -O3 -std=c++11 -DGIT_REV="\"$(git rev-parse --short HEAD)\"" MMult0_pack.cpp -I${PAPI_DIR}/include -L${PAPI_DIR}/lib -lpapi
+// $ ./a.out -n 1000 -pf 64 -nt 1
+
+#include <stdio.h>
+#include <papi.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+#include "results.h"
+
+#define CACHE_LINE 64
+#define DOUBLES_PER_LINE (CACHE_LINE / sizeof(double))
+#define MAX_EVENTS 8
+
+void handle_error (int retval)
+{
+     printf("PAPI error %d: %s\n", retval, PAPI_strerror(retval));
+     exit(1);
+}
+
+// Copy rows [i0, i0+mb) of the (m x k) matrix A into ap so that column p of
+// the panel is the contiguous run ap[p*mb .. p*mb+mb). If pf > 0, the element
+// pf doubles further along the packing walk is prefetched once per cache line.
+void pack_A( long m, long k, long i0, long mb, const double *a, double *ap,
+             long pf) {
+  for (long p = 0; p < k; p++) {
+    for (long ii = 0; ii < mb; ii++) {
+      if (pf > 0 && ii % DOUBLES_PER_LINE == 0) {
+        long pp = p + (ii + pf) / mb;
+        if (pp < k) __builtin_prefetch(&a[i0 + (ii + pf) % mb + pp*m], 0, 0);
+      }
+      ap[ii+p*mb] = a[i0+ii+p*m];
+    }
+  }
+}
+
+// Copy columns [j0, j0+nb) of the (k x n) matrix B into bp. Columns of B are
+// already contiguous, so the panel is a straight copy; the prefetch distance
+// has the same meaning as in pack_A.
+void pack_B( long k, long j0, long nb, const double *b, double *bp, long pf) {
+  const double *src = b + j0*k;
+  long len = k * nb;
+  for (long w = 0; w < len; w++) {
+    if (pf > 0 && w % DOUBLES_PER_LINE == 0 && w + pf < len)
+      __builtin_prefetch(&src[w+pf], 0, 0);
+    bp[w] = src[w];
+  }
+}
+
+// Store len doubles from src to dst. With nt set, stores bypass the cache
+// hierarchy (movntpd) for the 16-byte aligned part of dst; the unaligned
+// head/tail and non-SSE2 builds fall back to plain stores.
+void write_back( double *dst, const double *src, long len, int nt) {
+  long i = 0;
+#if defined(__SSE2__)
+  if (nt) {
+    for (; i < len && ((unsigned long)(dst+i) & 15); i++) dst[i] = src[i];
+    for (; i + 1 < len; i += 2) _mm_stream_pd(dst+i, _mm_loadu_pd(src+i));
+  }
+#endif
+  for (; i < len; i++) dst[i] = src[i];
+}
+
+// Note: matrices are stored in column major order; i.e. the array elements in
+// the (m x n) matrix C are stored in the sequence: {C_00, C_10, ..., C_m0,
+// C_01, C_11, ..., C_m1, C_02, ..., C_0n, C_1n, ..., C_mn}
+// C is processed in (mb x nb) blocks. Each block is accumulated in cb over the
+// full k range, so every element of C is written back exactly once per call;
+// this is what makes non-temporal stores for C meaningful.
+void MMult0_pack( long m, long n, long k, double *a,
+                                          double *b,
+                                          double *c,
+                  long mb, long nb, long pf, int nt,
+                  double *ap, double *bp, double *cb) {
+  for (long j0 = 0; j0 < n; j0 += nb) {
+    long nbb = (n - j0 < nb) ? n - j0 : nb;
+    pack_B(k, j0, nbb, b, bp, pf);
+    for (long i0 = 0; i0 < m; i0 += mb) {
+      long mbb = (m - i0 < mb) ? m - i0 : mb;
+      pack_A(m, k, i0, mbb, a, ap, pf);
+
+      for (long jj = 0; jj < nbb; jj++)
+        for (long ii = 0; ii < mbb; ii++)
+          cb[ii+jj*mbb] = c[i0+ii+(j0+jj)*m];
+
+      for (long jj = 0; jj < nbb; jj++) {
+        for (long p = 0; p < k; p++) {
+          double B_pj = bp[p+jj*k];
+          for (long ii = 0; ii < mbb; ii++) {
+            cb[ii+jj*mbb] += ap[ii+p*mbb] * B_pj;
+          }
+        }
+      }
+
+      for (long jj = 0; jj < nbb; jj++)
+        write_back(&c[i0+(j0+jj)*m], &cb[jj*mbb], mbb, nt);
+    }
+  }
+#if defined(__SSE2__)
+  // streaming stores are weakly ordered; make them visible before returning
+  if (nt) _mm_sfence();
+#endif
+}
+
+int main(int argc, char** argv) {
+
+  const long NREPEATS = read_option<long>("-r", argc, argv, "50");
+  long p  = read_option<long>("-n", argc, argv, "400");
+  long mb = read_option<long>("-mb", argc, argv, "64");
+  long nb = read_option<long>("-nb", argc, argv, "64");
+  long pf = read_option<long>("-pf", argc, argv, "0");
+  int nt  = read_option<int>("-nt", argc, argv, "0");
+  std::string events = read_option<std::string>("-events", argc, argv, "");
+  std::string results = read_option<std::string>("-results", argc, argv, "");
+  long m = p, n = p, k = p;
+
+  // split -events on commas
+  std::string event_names[MAX_EVENTS];
+  int num_events = 0;
+  for (size_t pos = 0; pos < events.size(); ) {
+    size_t end = events.find(',', pos);
+    if (end == std::string::npos) end = events.size();
+    if (end > pos) {
+      if (num_events == MAX_EVENTS) {
+        fprintf(stderr, "At most %d events can be given with -events\n", MAX_EVENTS);
+        exit(1);
+      }
+      event_names[num_events++] = events.substr(pos, end - pos);
+    }
+    pos = end + 1;
+  }
+
+  if (p <= 0 || NREPEATS <= 0 || mb <= 0 || nb <= 0 || pf < 0 ||
+      (nt != 0 && nt != 1)) {
+    fprintf(stderr, "Usage: %s [-n dim > 0] [-r repeats > 0] [-mb rows > 0]"
+            " [-nb cols > 0] [-pf dist >= 0] [-nt 0|1] [-events NAME,...]"
+            " [-results file]\n", argv[0]);
+    exit(1);
+  }
+
+  if (mb > m) mb = m;
+  if (nb > n) nb = n;
+
+  // alloc memory
+  double* a = (double*) malloc(m * k * sizeof(double)); // m x k
+  double* b = (double*) malloc(k * n * sizeof(double)); // k x n
+  double* c = (double*) malloc(m * n * sizeof(double)); // m x n
+  double* ap = (double*) malloc(mb * k * sizeof(double)); // packed A panel
+  double* bp = (double*) malloc(k * nb * sizeof(double)); // packed B panel
+  double* cb = (double*) malloc(mb * nb * sizeof(double)); // C block
+
+  // Initialize matrices
+  for (long i = 0; i < m*k; i++) a[i] = drand48();
+  for (long i = 0; i < k*n; i++) b[i] = drand48();
+  for (long i = 0; i < m*n; i++) c[i] = drand48();
+
+  int retval;
+  int EventSet = PAPI_NULL;
+  long_long values[1 + MAX_EVENTS] = {0};
+
+  /* Initialize the PAPI library */
+  retval = PAPI_library_init(PAPI_VER_CURRENT);
+  if (retval != PAPI_VER_CURRENT && retval > 0) {
+    fprintf(stderr,"PAPI library version mismatch!");
+    exit(1);
+  }
+
+  if (retval < 0)
+    handle_error(retval);
+
+  if ((retval = PAPI_create_eventset(&EventSet)) != PAPI_OK)
+    handle_error(retval);
+
+  /* Last level cache misses; not every CPU exposes this preset */
+  int have_llc = (PAPI_query_event(PAPI_L3_TCM) == PAPI_OK);
+  if (have_llc && (retval = PAPI_add_event(EventSet, PAPI_L3_TCM)) != PAPI_OK)
+    handle_error(retval);
+  if (!have_llc)
+    fprintf(stderr, "PAPI_L3_TCM not available, LLC-miss reported as -1\n");
+
+  /* User requested events come after PAPI_L3_TCM in the event set */
+  for (int e = 0; e < num_events; e++) {
+    if ((retval = PAPI_add_named_event(EventSet, event_names[e].c_str())) != PAPI_OK) {
+      fprintf(stderr, "Cannot add event %s\n", event_names[e].c_str());
+      handle_error(retval);
+    }
+  }
+  int counting = have_llc || num_events > 0;
+
+  if (counting && (retval = PAPI_start(EventSet)) != PAPI_OK)
+    handle_error(retval);
+
+  Timer t;
+  t.tic();
+
+  // do function MMult0_pack for @NREPEATS@ times
+  for (long rep = 0; rep < NREPEATS; rep++) {
+    MMult0_pack(m, n, k, a, b, c, mb, nb, pf, nt, ap, bp, cb);
+  }
+
+  double time = t.toc(); // unit: second
+
+  if (counting && (retval = PAPI_stop(EventSet, values)) != PAPI_OK)
+    handle_error(retval);
+
+  long long llc_miss = have_llc ? values[0] : -1;
+  long_long *event_values = values + have_llc;
+  double flops = (((2 * m * n * k) * NREPEATS) / 1e9) / time;
+  double bandwidth = (((4 * m * n * k) * NREPEATS * sizeof(double)) / 1e9) / time;
+  double llc_bw = have_llc ? ((llc_miss * CACHE_LINE) / 1e9) / time : -1;
+
+  printf(" Dimension       Time    Gflop/s       GB/s   LLC-miss LLC-miss-GB/s");
+  for (int e = 0; e < num_events; e++) printf(" %s", event_names[e].c_str());
+  printf("   pf nt\n");
+  printf("%10ld %10f %10f %10f %10lld %13f",
+         p, time, flops, bandwidth, llc_miss, llc_bw);
+  for (int e = 0; e < num_events; e++)
+    printf(" %*lld", (int) event_names[e].size(), event_values[e]);
+  printf(" %4ld %2d\n", pf, nt);
+
+  if (!results.empty()) {
+    char config[128];
+    snprintf(config, sizeof(config), "r=%ld,mb=%ld,nb=%ld,pf=%ld,nt=%d",
+             NREPEATS, mb, nb, pf, nt);
+    std::string counters = "PAPI_L3_TCM=" + std::to_string(llc_miss);
+    for (int e = 0; e < num_events; e++)
+      counters += "," + event_names[e] + "=" + std::to_string(event_values[e]);
+    append_result(results.c_str(), "MMult0_pack", config, p, time, flops,
+                  bandwidth, counters);
+  }
+
+  if ((retval = PAPI_cleanup_eventset(EventSet)) != PAPI_OK)
+    handle_error(retval);
+  if ((retval = PAPI_destroy_eventset(&EventSet)) != PAPI_OK)
+    handle_error(retval);
+
+  free(a);
+  free(b);
+  free(c);
+  free(ap);
+  free(bp);
+  free(cb);
+
+  return 0;
+
+}
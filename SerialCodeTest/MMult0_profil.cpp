@@ -3,13 +3,15 @@
 // + Specify the the compiler version (using the command: "g++ -v")
 // + Try to find out the frequency, the maximum flop-rate and the maximum main
 //   memory bandwidth for your processor.
-// $ g++ -O3 -std=c++11 MMult0.cpp && ./a.out
+// $ g++ -O3 -std=c++11 -DGIT_REV="\"$(git rev-parse --short HEAD)\"" MMult0_profil.cpp -I${PAPI_DIR}/include -L${PAPI_DIR}/lib -lpapi
+// $ ./a.out -results results.tsv
 
 #include <stdio.h>
 #include <papi.h>
 
 #include "utils.h"
 #include "prof_utils.h"
+#include "results.h"
 
 /* value for scale parameter that sets scale to 1 */
 #define FULL_SCALE 65536
@@ -218,6 +220,7 @@ void MMult0( long m, long n, long k, double *a,
 int main(int argc, char** argv) {
     
   const long NREPEATS = 50;
+  std::string results = read_option<std::string>("-results", argc, argv, "");
   /*
   const long PFIRST = 20;
   const long PLAST = 600;
@@ -314,6 +317,9 @@ int main(int argc, char** argv) {
     double flops = (((2 * m * n * k) * NREPEATS) / 1e9) / time;
     double bandwidth = (((4 * m * n * k) * NREPEATS * sizeof(double)) / 1e9) / time;
     printf("%10ld %10f %10f %10f\n", p, time, flops, bandwidth);
+    if (!results.empty())
+      append_result(results.c_str(), "MMult0_profil", "", p, time, flops, bandwidth,
+                    "PAPI_FP_INS=" + std::to_string(values[0]));
     
     prof_head( blength, bucket, num_buckets,
 				   "address\t\t\tflat\n" );
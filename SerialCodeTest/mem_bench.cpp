@@ -0,0 +1,256 @@
+// Memory-system microbenchmarks, to find out the maximum main memory bandwidth
+// and the load latency of each cache level on your machine. Kernel efficiency
+// of the MMult drivers can then be normalized against these limits.
+// + stream:  STREAM copy/scale/add/triad on arrays of -n doubles
+// + latency: pointer chasing over working sets from 4 KB up to -maxws bytes
+// + scaling: triad bandwidth with 1, 2, 4, ... up to -t threads (OpenMP)
+// Select with -mode stream|latency|scaling|all (default all). Rows use the
+// same columns as the GEMM drivers; Dimension is the array length for STREAM
+// and the working set in bytes for the latency sweep. -results <file> appends
+// every row to a results file (see results.h).
+// $ g++ -O3 -std=c++11 -fopenmp -DGIT_REV="\"$(git rev-parse --short HEAD)\"" mem_bench.cpp -I${PAPI_DIR}/include -L${PAPI_DIR}/lib -lpapi
+// $ ./a.out -mode all -n 20000000 -maxws 268435456
+
+#include <stdio.h>
+#include <papi.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "utils.h"
+#include "results.h"
+
+#define CACHE_LINE 64
+#define LINE_STRIDE (CACHE_LINE / sizeof(long))
+
+// end of the pointer chase, stored so the loads cannot be optimized away
+volatile long chase_sink;
+
+void handle_error (int retval)
+{
+     printf("PAPI error %d: %s\n", retval, PAPI_strerror(retval));
+     exit(1);
+}
+
+enum StreamKernel { COPY, SCALE, ADD, TRIAD };
+static const char* kernel_name[] = { "copy", "scale", "add", "triad" };
+// words moved and flops per element, as counted by STREAM
+static const long kernel_words[] = { 2, 2, 3, 3 };
+static const long kernel_flops[] = { 0, 1, 1, 2 };
+
+// Run one STREAM kernel and return its time in seconds. If region is not
+// NULL, every thread of the team opens the PAPI region around its share of
+// the loop, so the counters of the multi-threaded rows include all worker
+// threads and not only the master. The timer only covers the work-sharing
+// loop: it starts after every thread has opened its region and stops at the
+// loop's closing barrier, before the regions are closed.
+double stream_kernel( StreamKernel kernel, long n, double *a, double *b,
+                      double *c, double scalar, const char *region) {
+  Timer t;
+  double time = 0;
+
+#pragma omp parallel
+  {
+    if (region != NULL && PAPI_hl_region_begin(region) != PAPI_OK)
+      handle_error(1);
+
+    // the implied barrier of single holds every thread until the timer runs
+#pragma omp single
+    t.tic();
+
+    switch (kernel) {
+    case COPY:
+#pragma omp for schedule(static)
+      for (long i = 0; i < n; i++) c[i] = a[i];
+      break;
+    case SCALE:
+#pragma omp for schedule(static)
+      for (long i = 0; i < n; i++) b[i] = scalar * c[i];
+      break;
+    case ADD:
+#pragma omp for schedule(static)
+      for (long i = 0; i < n; i++) c[i] = a[i] + b[i];
+      break;
+    case TRIAD:
+#pragma omp for schedule(static)
+      for (long i = 0; i < n; i++) a[i] = b[i] + scalar * c[i];
+      break;
+    }
+
+#pragma omp single nowait
+    time = t.toc(); // unit: second
+
+    if (region != NULL && PAPI_hl_region_end(region) != PAPI_OK)
+      handle_error(1);
+  }
+
+  return time;
+}
+
+// Run one STREAM kernel NREPEATS times and report the best repetition, as
+// STREAM does. A warm-up repetition runs first, outside the PAPI region. The
+// region (named per row, e.g. "triad_t4") accumulates all NREPEATS timed
+// repetitions, so its counters are totals over NREPEATS runs while the row
+// reports the best one.
+void run_stream( StreamKernel kernel, long n, long NREPEATS, int threads,
+                 double *a, double *b, double *c, const std::string& results) {
+  double best = 0;
+  char region[32];
+  snprintf(region, sizeof(region), "%s_t%d", kernel_name[kernel], threads);
+
+  stream_kernel(kernel, n, a, b, c, 3.0, NULL);
+
+  for (long rep = 0; rep < NREPEATS; rep++) {
+    double time = stream_kernel(kernel, n, a, b, c, 3.0, region);
+    if (best == 0 || time < best) best = time;
+  }
+
+  double flops = ((kernel_flops[kernel] * n) / 1e9) / best;
+  double bandwidth = ((kernel_words[kernel] * n * sizeof(double)) / 1e9) / best;
+  printf("%10ld %10f %10f %10f   %s %d\n", n, best, flops, bandwidth,
+         kernel_name[kernel], threads);
+
+  if (!results.empty()) {
+    char config[64];
+    snprintf(config, sizeof(config), "kernel=%s,threads=%d",
+             kernel_name[kernel], threads);
+    append_result(results.c_str(), "mem_bench", config, n, best, flops,
+                  bandwidth, "");
+  }
+}
+
+// Link the cache lines of a (bytes)-sized buffer into a single random cycle
+// (Sattolo's algorithm) so that hardware prefetchers cannot guess the next
+// address, then time `loads` dependent loads around it.
+void run_latency( long bytes, long loads, const std::string& results) {
+  long lines = bytes / CACHE_LINE;
+  long* buf = (long*) malloc(lines * CACHE_LINE);
+  long* order = (long*) malloc(lines * sizeof(long));
+
+  for (long i = 0; i < lines; i++) order[i] = i;
+  for (long i = lines - 1; i > 0; i--) {
+    long j = (long)(drand48() * i); // j in [0, i)
+    long tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+  }
+  for (long i = 0; i < lines; i++)
+    buf[order[i] * LINE_STRIDE] = order[(i + 1) % lines] * LINE_STRIDE;
+
+  // warm up: walk the whole cycle once
+  long idx = 0;
+  for (long i = 0; i < lines; i++) idx = buf[idx];
+
+  // one region per working set, bracketing only the timed chase
+  char region[32];
+  snprintf(region, sizeof(region), "latency_%ld", bytes);
+
+  int retval = PAPI_hl_region_begin(region);
+  if ( retval != PAPI_OK )
+    handle_error(1);
+
+  Timer t;
+  t.tic();
+  for (long i = 0; i < loads; i++) idx = buf[idx];
+  double time = t.toc(); // unit: second
+
+  retval = PAPI_hl_region_end(region);
+  if ( retval != PAPI_OK )
+    handle_error(1);
+
+  // dependent loads measure latency, not bandwidth, so Gflop/s and GB/s are
+  // left at 0 and ns/load is stored with the counters
+  double ns = time * 1e9 / loads;
+  chase_sink = idx;
+  printf("%10ld %10f %10f %10f   %.2f ns/load\n", bytes, time, 0.0, 0.0, ns);
+
+  if (!results.empty()) {
+    char config[64], counters[64];
+    snprintf(config, sizeof(config), "kernel=latency,loads=%ld", loads);
+    snprintf(counters, sizeof(counters), "ns_per_load=%.4f", ns);
+    append_result(results.c_str(), "mem_bench", config, bytes, time, 0.0,
+                  0.0, counters);
+  }
+
+  free(buf);
+  free(order);
+}
+
+int main(int argc, char** argv) {
+
+  std::string mode = read_option<std::string>("-mode", argc, argv, "all");
+  const long NREPEATS = read_option<long>("-r", argc, argv, "10");
+  long n = read_option<long>("-n", argc, argv, "20000000");
+  long maxws = read_option<long>("-maxws", argc, argv, "268435456");
+  long loads = read_option<long>("-loads", argc, argv, "16777216");
+  std::string results = read_option<std::string>("-results", argc, argv, "");
+#if defined(_OPENMP)
+  int max_threads = read_option<int>("-t", argc, argv,
+                                     std::to_string(omp_get_max_threads()).c_str());
+#else
+  int max_threads = 1;
+#endif
+
+  if (NREPEATS <= 0 || n <= 0 || loads <= 0 || max_threads <= 0) {
+    fprintf(stderr, "Usage: %s [-mode stream|latency|scaling|all] [-r repeats > 0]"
+            " [-n length > 0] [-maxws bytes] [-loads count > 0] [-t threads > 0]"
+            " [-results file]\n", argv[0]);
+    return 1;
+  }
+
+  bool all = (mode == "all");
+  if (!all && mode != "stream" && mode != "latency" && mode != "scaling") {
+    fprintf(stderr, "Unknown mode %s\n", mode.c_str());
+    return 1;
+  }
+
+  if (all || mode == "stream" || mode == "scaling") {
+    // alloc memory
+    double* a = (double*) malloc(n * sizeof(double));
+    double* b = (double*) malloc(n * sizeof(double));
+    double* c = (double*) malloc(n * sizeof(double));
+
+    // Initialize in parallel so pages are first touched by the thread using them
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++) {
+      a[i] = 1.0;
+      b[i] = 2.0;
+      c[i] = 0.0;
+    }
+
+    if (all || mode == "stream") {
+#if defined(_OPENMP)
+      omp_set_num_threads(max_threads);
+#endif
+      printf(" Dimension       Time    Gflop/s       GB/s   Kernel Threads\n");
+      run_stream(COPY, n, NREPEATS, max_threads, a, b, c, results);
+      run_stream(SCALE, n, NREPEATS, max_threads, a, b, c, results);
+      run_stream(ADD, n, NREPEATS, max_threads, a, b, c, results);
+      run_stream(TRIAD, n, NREPEATS, max_threads, a, b, c, results);
+    }
+
+    if (all || mode == "scaling") {
+      printf(" Dimension       Time    Gflop/s       GB/s   Kernel Threads\n");
+      for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+#if defined(_OPENMP)
+        omp_set_num_threads(threads);
+#endif
+        run_stream(TRIAD, n, NREPEATS, threads, a, b, c, results);
+        if (threads == max_threads) break;
+      }
+    }
+
+    free(a);
+    free(b);
+    free(c);
+  }
+
+  if (all || mode == "latency") {
+    printf(" Dimension       Time    Gflop/s       GB/s   Latency\n");
+    for (long bytes = 4096; bytes <= maxws; bytes *= 2) {
+      run_latency(bytes, loads, results);
+    }
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,272 @@
+// Compare benchmark runs stored by the drivers (see results.h) and flag
+// statistically significant regressions.
+// Runs are grouped by (driver, config, dimension, cpu, flags, compiler), so
+// builds with different options are never pooled. For each group the
+// samples of the base revision are compared with those of the test revision
+// using a two-sided Mann-Whitney U test (exact distribution for small samples
+// without ties, normal approximation otherwise); a metric is reported as a
+// regression when p < alpha and its median grew by more than the threshold.
+// A metric whose sample sizes cannot reach p < alpha even for completely
+// separated samples (e.g. 3 runs vs 3 runs at alpha 0.05) is reported as
+// inconclusive; identical samples on both sides (deterministic counters) are
+// simply ok. All metrics (time and every PAPI counter) are treated as
+// lower-is-better.
+// Options:
+// + -f <file>:     results file (default results.tsv)
+// + -base <rev>:   baseline git revision (default: revision of the most recent
+//                  row that is not from the test revision)
+// + -test <rev>:   revision under test (default: revision of the last row)
+// + -alpha <p>:    significance level (default 0.05)
+// + -t <frac>:     minimum relative median change to report (default 0.02)
+// Exit status: 0 no regression, 1 regression found, 2 bad input (including a
+// revision with no rows, or no group measured by both revisions), 3 no
+// regression found but at least one metric was inconclusive. Anything but 0
+// should fail a gate. Revisions are matched literally against the git_rev
+// column, which holds short hashes:
+// $ g++ -O3 -std=c++11 perf_report.cpp -o perf_report
+// $ ./perf_report -f results.tsv -base 9cb278d -test $(git rev-parse --short HEAD)
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// Largest sample size per side for which the exact U distribution is used.
+#define EXACT_MAX 25
+
+struct Run {
+  std::string rev;
+  std::string key; // driver \t config \t dimension \t cpu \t flags \t compiler
+  std::map<std::string, double> metrics;
+};
+
+static std::vector<std::string> split(const std::string& s, char sep) {
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, sep)) out.push_back(item);
+  return out;
+}
+
+// Read the results file. Columns are located by name from the header line so
+// that older files with fewer columns still load.
+static int load_runs(const char* path, std::vector<Run>& runs) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "Cannot open results file %s\n", path);
+    return -1;
+  }
+  std::string line;
+  if (!std::getline(in, line)) return 0;
+  std::vector<std::string> header = split(line, '\t');
+  std::map<std::string, size_t> col;
+  for (size_t i = 0; i < header.size(); i++) col[header[i]] = i;
+  const char* required[] = {"git_rev", "driver", "config", "dimension", "cpu", "time"};
+  for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); i++) {
+    if (!col.count(required[i])) {
+      fprintf(stderr, "Results file %s has no '%s' column\n", path, required[i]);
+      return -1;
+    }
+  }
+
+  while (std::getline(in, line)) {
+    std::vector<std::string> f = split(line, '\t');
+    if (f.size() < header.size()) continue;
+    Run r;
+    r.rev = f[col["git_rev"]];
+    r.key = f[col["driver"]] + "\t" + f[col["config"]] + "\t" +
+            f[col["dimension"]] + "\t" + f[col["cpu"]] + "\t" +
+            (col.count("flags") ? f[col["flags"]] : "-") + "\t" +
+            (col.count("compiler") ? f[col["compiler"]] : "-");
+    r.metrics["time"] = strtod(f[col["time"]].c_str(), NULL);
+    if (col.count("counters")) {
+      std::vector<std::string> counters = split(f[col["counters"]], ',');
+      for (size_t i = 0; i < counters.size(); i++) {
+        // native event names may contain '=' (e.g. ":cpu=0"), the value
+        // follows the last one
+        size_t eq = counters[i].rfind('=');
+        if (eq == std::string::npos) continue;
+        double v = strtod(counters[i].c_str() + eq + 1, NULL);
+        if (v >= 0) r.metrics[counters[i].substr(0, eq)] = v;
+      }
+    }
+    runs.push_back(r);
+  }
+  return 0;
+}
+
+static double median(std::vector<double> v) {
+  std::sort(v.begin(), v.end());
+  size_t n = v.size();
+  return (n % 2) ? v[n/2] : 0.5 * (v[n/2-1] + v[n/2]);
+}
+
+// Two-sided p-value of U = u under the exact null distribution of the
+// Mann-Whitney statistic for sample sizes n1, n2 (no ties). counts[i][j][u]
+// is the number of orderings of i x's and j y's with statistic u.
+static double exact_u_pvalue(int n1, int n2, int u) {
+  int umax = n1 * n2;
+  std::vector<std::vector<std::vector<double> > > counts(n1 + 1,
+    std::vector<std::vector<double> >(n2 + 1, std::vector<double>(umax + 1, 0)));
+  for (int i = 0; i <= n1; i++) {
+    for (int j = 0; j <= n2; j++) {
+      if (i == 0 || j == 0) { counts[i][j][0] = 1; continue; }
+      for (int v = 0; v <= i * j; v++) {
+        // largest element is an x (beats all j y's) or a y
+        counts[i][j][v] = (v >= j ? counts[i-1][j][v-j] : 0) + counts[i][j-1][v];
+      }
+    }
+  }
+  double total = 0, below = 0, above = 0;
+  for (int v = 0; v <= umax; v++) {
+    total += counts[n1][n2][v];
+    if (v <= u) below += counts[n1][n2][v];
+    if (v >= u) above += counts[n1][n2][v];
+  }
+  return std::min(1.0, 2 * std::min(below, above) / total);
+}
+
+// Two-sided Mann-Whitney U test with average ranks for ties. Uses the exact
+// distribution when both samples have at most EXACT_MAX elements and there
+// are no ties, and otherwise the normal approximation with tie-corrected
+// variance and continuity correction. Returns the p-value; *p_min is set to
+// the smallest p-value these sample sizes could produce at all, i.e. for two
+// completely separated samples without ties.
+static double mann_whitney(const std::vector<double>& x, const std::vector<double>& y,
+                           double* p_min) {
+  double n1 = x.size(), n2 = y.size(), n = n1 + n2;
+  std::vector<std::pair<double, int> > all;
+  for (size_t i = 0; i < x.size(); i++) all.push_back(std::make_pair(x[i], 0));
+  for (size_t i = 0; i < y.size(); i++) all.push_back(std::make_pair(y[i], 1));
+  std::sort(all.begin(), all.end());
+
+  double r1 = 0, ties = 0;
+  for (size_t i = 0; i < all.size(); ) {
+    size_t j = i;
+    while (j < all.size() && all[j].first == all[i].first) j++;
+    double t = j - i;
+    double rank = 0.5 * (i + 1 + j); // average of ranks i+1 .. j
+    for (size_t q = i; q < j; q++)
+      if (all[q].second == 0) r1 += rank;
+    ties += t*t*t - t;
+    i = j;
+  }
+
+  double u = r1 - n1 * (n1 + 1) / 2;
+  double mu = n1 * n2 / 2;
+  bool exact = (n1 <= EXACT_MAX && n2 <= EXACT_MAX);
+  if (exact)
+    *p_min = exact_u_pvalue(n1, n2, 0);
+  else
+    *p_min = erfc(std::max(0.0, (mu - 0.5) / sqrt(n1 * n2 * (n + 1) / 12)) / sqrt(2.0));
+
+  if (ties == 0 && exact)
+    return exact_u_pvalue(n1, n2, (int) (u + 0.5));
+
+  double sigma = sqrt(n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1))));
+  if (sigma == 0) return 1.0; // every sample identical: no difference
+  double z = (fabs(u - mu) - 0.5) / sigma;
+  if (z < 0) z = 0;
+  return erfc(z / sqrt(2.0));
+}
+
+int main(int argc, char** argv) {
+
+  std::string path = read_option<std::string>("-f", argc, argv, "results.tsv");
+  std::string base = read_option<std::string>("-base", argc, argv, "");
+  std::string test = read_option<std::string>("-test", argc, argv, "");
+  double alpha = read_option<double>("-alpha", argc, argv, "0.05");
+  double threshold = read_option<double>("-t", argc, argv, "0.02");
+
+  std::vector<Run> runs;
+  if (load_runs(path.c_str(), runs) != 0)
+    return 2;
+
+  if (test.empty() && !runs.empty()) test = runs.back().rev;
+  if (base.empty()) {
+    for (size_t i = runs.size(); i-- > 0; ) {
+      if (runs[i].rev != test) { base = runs[i].rev; break; }
+    }
+  }
+  if (base.empty() || test.empty()) {
+    fprintf(stderr, "Need runs from two revisions to compare\n");
+    return 2;
+  }
+
+  // key -> metric -> samples, for the base and test revisions
+  std::map<std::string, std::map<std::string, std::vector<double> > > sb, st;
+  for (size_t i = 0; i < runs.size(); i++) {
+    std::map<std::string, std::map<std::string, std::vector<double> > >* s =
+      (runs[i].rev == base) ? &sb : (runs[i].rev == test) ? &st : NULL;
+    if (s == NULL) continue;
+    std::map<std::string, double>::const_iterator m;
+    for (m = runs[i].metrics.begin(); m != runs[i].metrics.end(); ++m)
+      (*s)[runs[i].key][m->first].push_back(m->second);
+  }
+
+  if (sb.empty() || st.empty()) {
+    fprintf(stderr, "No rows for revision %s in %s (git_rev holds short hashes,"
+            " e.g. $(git rev-parse --short HEAD))\n",
+            (sb.empty() ? base : test).c_str(), path.c_str());
+    return 2;
+  }
+
+  printf("base %s vs test %s (alpha %g, threshold %g)\n",
+         base.c_str(), test.c_str(), alpha, threshold);
+  printf("%-12s %-24s %10s %-16s %-12s %14s %14s %9s %9s  %s\n", "Driver",
+         "Config", "Dimension", "Flags", "Metric", "Base", "Test", "Change",
+         "p-value", "Status");
+
+  int regressions = 0, inconclusive = 0, compared = 0;
+  std::map<std::string, std::map<std::string, std::vector<double> > >::const_iterator g;
+  for (g = st.begin(); g != st.end(); ++g) {
+    if (!sb.count(g->first)) continue;
+    std::vector<std::string> key = split(g->first, '\t');
+    std::map<std::string, std::vector<double> >::const_iterator m;
+    for (m = g->second.begin(); m != g->second.end(); ++m) {
+      if (!sb[g->first].count(m->first)) continue;
+      const std::vector<double>& xb = sb[g->first][m->first];
+      const std::vector<double>& xt = m->second;
+      compared++;
+
+      double mb = median(xb), mt = median(xt);
+      double change = (mb != 0) ? (mt - mb) / mb : 0;
+      const char* status = "ok";
+      double p_min;
+      double p = mann_whitney(xb, xt, &p_min);
+      if (p_min >= alpha) {
+        status = "inconclusive (too few runs)";
+        inconclusive++;
+      } else {
+        if (p < alpha && change > threshold) {
+          status = "REGRESSION";
+          regressions++;
+        } else if (p < alpha && change < -threshold) {
+          status = "improved";
+        }
+      }
+      printf("%-12s %-24s %10s %-16s %-12s %14.6g %14.6g %+8.2f%% ",
+             key[0].c_str(), key[1].c_str(), key[2].c_str(), key[4].c_str(),
+             m->first.c_str(), mb, mt, 100 * change);
+      printf("%9.4f  %s\n", p, status);
+    }
+  }
+
+  if (compared == 0) {
+    fprintf(stderr, "Revisions %s and %s share no (driver, config, dimension,"
+            " cpu, flags, compiler) group; nothing was compared\n",
+            base.c_str(), test.c_str());
+    return 2;
+  }
+
+  printf("%d regression(s), %d inconclusive\n", regressions, inconclusive);
+  if (regressions) return 1;
+  return inconclusive ? 3 : 0;
+
+}
@@ -0,0 +1,145 @@
+#ifndef _RESULTS_H_
+#define _RESULTS_H_
+
+// Results store shared by the drivers. Every run appends one row to a
+// tab-separated file whose first line names the columns; perf_report.cpp reads
+// it back and compares runs. The git revision has to be passed in at compile
+// time; without it every row is "unknown" and runs cannot be told apart.
+// The flags column holds what the compiler itself reports about the build
+// (optimization, ISA extensions, OpenMP), followed by BUILD_FLAGS if given:
+// $ g++ -O3 -std=c++11 -DGIT_REV="\"$(git rev-parse --short HEAD)\"" -DBUILD_FLAGS="\"-O3\"" MMult0.cpp ...
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <fstream>
+
+#ifndef GIT_REV
+#define GIT_REV "unknown"
+#endif
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS ""
+#endif
+
+#define RESULTS_HEADER "timestamp\tgit_rev\tflags\tcompiler\tcpu\tdriver\tconfig\tdimension\ttime\tgflops\tgbs\tcounters"
+
+// Tabs and newlines would break the column layout, so squash them to spaces.
+static std::string results_field(const std::string& s) {
+  std::string out = s;
+  for (size_t i = 0; i < out.size(); i++)
+    if (out[i] == '\t' || out[i] == '\n' || out[i] == '\r') out[i] = ' ';
+  return out.empty() ? "-" : out;
+}
+
+// Build facts taken from predefined macros, so they cannot disagree with the
+// flags the file was really compiled with.
+static std::string results_build_facts() {
+  std::string facts;
+#if defined(__OPTIMIZE_SIZE__)
+  facts += "opt-size";
+#elif defined(__OPTIMIZE__)
+  facts += "opt";
+#else
+  facts += "no-opt";
+#endif
+#if defined(__FAST_MATH__)
+  facts += ",fast-math";
+#endif
+#if defined(__AVX512F__)
+  facts += ",avx512f";
+#elif defined(__AVX2__)
+  facts += ",avx2";
+#elif defined(__AVX__)
+  facts += ",avx";
+#elif defined(__SSE2__)
+  facts += ",sse2";
+#endif
+#if defined(__FMA__)
+  facts += ",fma";
+#endif
+#if defined(_OPENMP)
+  facts += ",openmp";
+#endif
+#if defined(NDEBUG)
+  facts += ",ndebug";
+#endif
+  if (strlen(BUILD_FLAGS) > 0) facts += std::string(" ") + BUILD_FLAGS;
+  return facts;
+}
+
+// Compiler name and version; __VERSION__ alone is just a version number on gcc.
+static std::string results_compiler() {
+#if defined(__clang__)
+  return std::string("clang ") + __clang_version__;
+#elif defined(__INTEL_COMPILER)
+  return "icc " + std::to_string(__INTEL_COMPILER);
+#elif defined(__GNUC__)
+  return std::string("gcc ") + __VERSION__;
+#elif defined(__VERSION__)
+  return __VERSION__;
+#else
+  return "unknown";
+#endif
+}
+
+// CPU model as reported by the kernel, or "unknown" if /proc is not there.
+static std::string results_cpu_model() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      size_t pos = line.find(':');
+      if (pos != std::string::npos) {
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos != std::string::npos) return line.substr(pos);
+      }
+    }
+  }
+  return "unknown";
+}
+
+// Append one run to the results file at path, writing the column header first
+// if the file is new. config identifies the tunables of the run (e.g.
+// "pf=64,nt=1") and counters is a "NAME=value,NAME=value" list of PAPI counter
+// values; either may be empty. Returns 0 on success, -1 if the file cannot be
+// opened.
+static int append_result(const char* path, const char* driver,
+                         const std::string& config, long dimension,
+                         double time, double gflops, double gbs,
+                         const std::string& counters) {
+  FILE* f = fopen(path, "a");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open results file %s\n", path);
+    return -1;
+  }
+  if (strcmp(GIT_REV, "unknown") == 0) {
+    static bool warned = false;
+    if (!warned)
+      fprintf(stderr, "Warning: built without -DGIT_REV, results rows are "
+              "recorded with git_rev \"unknown\"\n");
+    warned = true;
+  }
+
+  fseek(f, 0, SEEK_END);
+  if (ftell(f) == 0) fprintf(f, "%s\n", RESULTS_HEADER);
+
+  char stamp[32];
+  time_t now = ::time(NULL);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+  fprintf(f, "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\t%.9g\t%.9g\t%.9g\t%s\n",
+          stamp,
+          results_field(GIT_REV).c_str(),
+          results_field(results_build_facts()).c_str(),
+          results_field(results_compiler()).c_str(),
+          results_field(results_cpu_model()).c_str(),
+          results_field(driver).c_str(),
+          results_field(config).c_str(),
+          dimension, time, gflops, gbs,
+          results_field(counters).c_str());
+  fclose(f);
+  return 0;
+}
+
+#endif